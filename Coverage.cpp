@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2023 Clement Vuchener
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#include "Coverage.h"
+#include "Labor.h"
+
+#include "df/world.h"
+
+#include <array>
+#include <bitset>
+#include <unordered_map>
+
+using df::global::world;
+
+static constexpr int LaborCount = std::extent_v<decltype(df::unit::T_status::labors)>;
+
+namespace {
+
+struct UnitCoverage
+{
+    std::bitset<LaborCount> labors;
+    std::vector<df::work_detail *> work_details;
+};
+
+}
+
+static std::unordered_map<int32_t, UnitCoverage> units;
+static std::array<int, LaborCount> labor_units = {};
+static std::unordered_map<df::work_detail *, int> work_detail_units;
+
+void Coverage::updateUnit(df::unit *u, const std::vector<df::work_detail *> &work_details)
+{
+    auto &coverage = units[u->id];
+    std::bitset<LaborCount> labors;
+    for (int i = 0; i < LaborCount; ++i)
+        labors[i] = u->status.labors[i];
+    // only changed labors need updating
+    auto changed = coverage.labors ^ labors;
+    if (changed.any()) {
+        for (int i = 0; i < LaborCount; ++i)
+            if (changed[i])
+                labor_units[i] += labors[i] ? 1 : -1;
+        coverage.labors = labors;
+    }
+    if (coverage.work_details != work_details) {
+        for (auto wd: coverage.work_details) {
+            auto it = work_detail_units.find(wd);
+            if (--it->second == 0)
+                work_detail_units.erase(it);
+        }
+        for (auto wd: work_details)
+            ++work_detail_units[wd];
+        coverage.work_details = work_details;
+    }
+}
+
+void Coverage::refreshUnit(df::unit *u)
+{
+    std::vector<df::work_detail *> work_details;
+    Labor::getAppliedWorkDetails(u, work_details);
+    updateUnit(u, work_details);
+}
+
+void Coverage::removeUnit(int32_t id)
+{
+    auto it = units.find(id);
+    if (it == units.end())
+        return;
+    for (int i = 0; i < LaborCount; ++i)
+        if (it->second.labors[i])
+            --labor_units[i];
+    for (auto wd: it->second.work_details) {
+        auto wd_it = work_detail_units.find(wd);
+        if (--wd_it->second == 0)
+            work_detail_units.erase(wd_it);
+    }
+    units.erase(it);
+}
+
+void Coverage::refresh()
+{
+    clear();
+    std::vector<df::work_detail *> work_details;
+    for (auto u: world->units.active) {
+        Labor::getAppliedWorkDetails(u, work_details);
+        updateUnit(u, work_details);
+    }
+}
+
+void Coverage::clear()
+{
+    units.clear();
+    labor_units.fill(0);
+    work_detail_units.clear();
+}
+
+int Coverage::laborUnits(int labor)
+{
+    return labor_units[labor];
+}
+
+int Coverage::workDetailUnits(df::work_detail *wd)
+{
+    auto it = work_detail_units.find(wd);
+    return it == work_detail_units.end() ? 0 : it->second;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2023 Clement Vuchener
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#include "df/unit.h"
+#include "df/work_detail.h"
+
+#include <vector>
+
+// Number of units having each labor enabled, and number of units each work
+// detail applies to. Counts are updated incrementally when unit labors are
+// updated.
+namespace Coverage
+{
+
+// Update counts from current unit labors and the work details applying to the unit.
+void updateUnit(df::unit *u, const std::vector<df::work_detail *> &work_details);
+// Update counts for a unit whose labors were changed by the game.
+void refreshUnit(df::unit *u);
+void removeUnit(int32_t id);
+// Recompute all counts after the game changed work details.
+void refresh();
+void clear();
+
+int laborUnits(int labor);
+int workDetailUnits(df::work_detail *wd);
+
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2023 Clement Vuchener
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#include "Generation.h"
+
+#include "MiscUtils.h"
+
+#include "df/plotinfost.h"
+#include "df/world.h"
+
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+using df::global::plotinfo;
+using df::global::world;
+
+namespace {
+
+struct Tracked
+{
+    std::uint64_t checksum = 0;
+    std::uint64_t generation = 0;
+};
+
+struct UnitState
+{
+    Tracked labors;
+    Tracked flags;
+};
+
+}
+
+// Start from a random value so generations saved by clients before a plugin
+// reload are very unlikely to match. Top bits are left clear so the counter
+// never wraps.
+static std::uint64_t random_start()
+{
+    std::random_device rd;
+    auto value = std::uint64_t(rd()) << 32 | rd();
+    return value >> 2;
+}
+
+static std::uint64_t counter = random_start();
+static Tracked work_detail_list;
+static Tracked unit_list;
+static std::unordered_map<df::work_detail *, Tracked> work_details;
+static std::unordered_map<int32_t, UnitState> units;
+
+// FNV-1a, cheap enough to run over every unit at each update.
+static constexpr std::uint64_t ChecksumInit = 14695981039346656037ull;
+
+static std::uint64_t checksum_bytes(std::uint64_t h, const void *data, std::size_t size)
+{
+    auto bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+template <typename T>
+static std::uint64_t checksum_value(std::uint64_t h, const T &value)
+{
+    return checksum_bytes(h, &value, sizeof(value));
+}
+
+static std::uint64_t work_detail_list_checksum()
+{
+    const auto &list = plotinfo->labor_info.work_details;
+    return checksum_bytes(ChecksumInit, list.data(), list.size()*sizeof(df::work_detail *));
+}
+
+static std::uint64_t unit_list_checksum()
+{
+    auto h = ChecksumInit;
+    for (auto u: world->units.active)
+        h = checksum_value(h, u->id);
+    return h;
+}
+
+static std::uint64_t work_detail_checksum(df::work_detail *wd)
+{
+    auto h = ChecksumInit;
+    h = checksum_bytes(h, wd->name.data(), wd->name.size());
+    h = checksum_value(h, wd->work_detail_flags.whole);
+    h = checksum_value(h, wd->icon);
+    h = checksum_value(h, wd->allowed_labors);
+    h = checksum_bytes(h, wd->assigned_units.data(), wd->assigned_units.size()*sizeof(int32_t));
+    return h;
+}
+
+static std::uint64_t unit_labors_checksum(df::unit *u)
+{
+    return checksum_value(ChecksumInit, u->status.labors);
+}
+
+// Only the flags exposed by the plugin are used, other flags change all the
+// time during the game.
+static std::uint64_t unit_flags_checksum(df::unit *u)
+{
+    std::uint32_t flags = u->flags2.bits.slaughter
+        | u->flags3.bits.available_for_adoption << 1
+        | u->flags3.bits.marked_for_gelding << 2
+        | u->flags4.bits.only_do_assigned_jobs << 3;
+    auto h = checksum_value(ChecksumInit, flags);
+    h = checksum_bytes(h, u->name.nickname.data(), u->name.nickname.size());
+    return h;
+}
+
+static void bump(Tracked &tracked, std::uint64_t checksum)
+{
+    tracked.checksum = checksum;
+    tracked.generation = ++counter;
+}
+
+static bool update(Tracked &tracked, std::uint64_t checksum, bool force = false)
+{
+    if (!force && tracked.checksum == checksum)
+        return false;
+    bump(tracked, checksum);
+    return true;
+}
+
+std::uint64_t Generation::current()
+{
+    return counter;
+}
+
+std::uint64_t Generation::workDetailList()
+{
+    return work_detail_list.generation;
+}
+
+std::uint64_t Generation::unitList()
+{
+    return unit_list.generation;
+}
+
+std::uint64_t Generation::workDetail(df::work_detail *wd)
+{
+    auto it = work_details.find(wd);
+    return it == work_details.end() ? 0 : it->second.generation;
+}
+
+std::uint64_t Generation::unitLabors(df::unit *u)
+{
+    auto it = units.find(u->id);
+    return it == units.end() ? 0 : it->second.labors.generation;
+}
+
+std::uint64_t Generation::unitFlags(df::unit *u)
+{
+    auto it = units.find(u->id);
+    return it == units.end() ? 0 : it->second.flags.generation;
+}
+
+void Generation::bumpWorkDetailList()
+{
+    bump(work_detail_list, work_detail_list_checksum());
+    // forget removed work details
+    std::erase_if(work_details, [](const auto &entry) {
+            return !vector_contains(plotinfo->labor_info.work_details, entry.first);
+        });
+}
+
+void Generation::bumpWorkDetail(df::work_detail *wd)
+{
+    auto [it, inserted] = work_details.try_emplace(wd);
+    update(it->second, work_detail_checksum(wd), inserted);
+}
+
+void Generation::bumpUnitLabors(df::unit *u)
+{
+    bump(units[u->id].labors, unit_labors_checksum(u));
+}
+
+void Generation::bumpUnitFlags(df::unit *u)
+{
+    auto [it, inserted] = units.try_emplace(u->id);
+    update(it->second.flags, unit_flags_checksum(u), inserted);
+}
+
+void Generation::check(Changes &changes)
+{
+    if (work_detail_list_checksum() != work_detail_list.checksum) {
+        bumpWorkDetailList();
+        changes.work_details = true;
+    }
+    for (auto wd: plotinfo->labor_info.work_details) {
+        auto [it, inserted] = work_details.try_emplace(wd);
+        changes.work_details |= update(it->second, work_detail_checksum(wd), inserted);
+    }
+    if (update(unit_list, unit_list_checksum())) {
+        // forget units that left
+        std::unordered_set<int32_t> active;
+        for (auto u: world->units.active)
+            active.insert(u->id);
+        std::erase_if(units, [&](const auto &entry) {
+                if (active.contains(entry.first))
+                    return false;
+                changes.removed_units.push_back(entry.first);
+                return true;
+            });
+    }
+    for (auto u: world->units.active) {
+        auto [it, inserted] = units.try_emplace(u->id);
+        if (update(it->second.labors, unit_labors_checksum(u), inserted))
+            changes.unit_labors.push_back(u);
+        update(it->second.flags, unit_flags_checksum(u), inserted);
+    }
+}
+
+void Generation::clear()
+{
+    work_details.clear();
+    units.clear();
+    // the counter keeps increasing so clients notice the change
+    bump(work_detail_list, 0);
+    bump(unit_list, 0);
+}
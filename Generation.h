@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2023 Clement Vuchener
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#include "df/unit.h"
+#include "df/work_detail.h"
+
+#include <cstdint>
+#include <vector>
+
+// Every generation is taken from a single monotonic counter starting from a
+// random value: any change makes current() grow, and all per-object
+// generations are less or equal to it.
+namespace Generation
+{
+
+std::uint64_t current();
+
+std::uint64_t workDetailList();
+std::uint64_t unitList();
+std::uint64_t workDetail(df::work_detail *wd);
+std::uint64_t unitLabors(df::unit *u);
+std::uint64_t unitFlags(df::unit *u);
+
+void bumpWorkDetailList();
+// Work detail and unit flag generations are only bumped if their checksum changed.
+void bumpWorkDetail(df::work_detail *wd);
+void bumpUnitLabors(df::unit *u);
+void bumpUnitFlags(df::unit *u);
+
+// Changes found by check()
+struct Changes
+{
+    bool work_details = false; // work detail list or any work detail
+    std::vector<df::unit *> unit_labors; // labors changed or unit arrived
+    std::vector<int32_t> removed_units; // ids of units that left
+};
+
+// Compare checksums with the game state and bump anything that was modified
+// without going through this plugin.
+void check(Changes &changes);
+// Forget per-object state when the world or map is unloaded.
+void clear();
+
+}
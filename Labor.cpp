@@ -22,6 +22,8 @@
 
 #include "modules/Units.h"
 #include "modules/Job.h"
+#include "Coverage.h"
+#include "Generation.h"
 #include "UnitsEx.h"
 
 #include "df/gamest.h"
@@ -31,23 +33,47 @@
 #include "df/occupation.h"
 #include "df/plotinfost.h"
 #include "df/work_detail.h"
+#include "df/world.h"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace DFHack;
 using df::global::game;
 using df::global::plotinfo;
+using df::global::world;
 
 static constexpr int LaborCount = std::extent_v<decltype(df::unit::T_status::labors)>;
 
-static void cancel_pickup_mismatched_equipment(df::unit *u)
+static int batch_depth = 0;
+static bool full_update_pending = false;
+// Tool labors of units updated in the current batch, before their first update
+static std::unordered_map<df::unit *, int> tool_labors_before;
+// Ids of units waiting for their re-equipment request, in request order
+static std::deque<int32_t> reequip_queue;
+static std::unordered_set<int32_t> reequip_queued;
+static std::size_t reequip_rate = 0;
+
+static int tool_labors(df::unit *u)
+{
+    return u->status.labors[df::unit_labor::MINE]
+        | u->status.labors[df::unit_labor::CUTWOOD] << 1
+        | u->status.labors[df::unit_labor::HUNT] << 2;
+}
+
+static df::job *find_pickup_mismatched_equipment(df::unit *u)
 {
     auto job = u->job.current_job;
     if (!job || job->job_type != df::job_type::PickupEquipment)
-        return;
+        return nullptr;
     if (job->items.empty())
-        return;
+        return nullptr;
     auto item = job->items.front()->item;
     if (item->getType() != df::item_type::WEAPON)
-        return;
+        return nullptr;
     auto weapon_skill = static_cast<df::job_skill>(item->getRangedSkill());
     if (weapon_skill == df::job_skill::NONE)
         weapon_skill = static_cast<df::job_skill>(item->getMeleeSkill());
@@ -57,43 +83,149 @@ static void cancel_pickup_mismatched_equipment(df::unit *u)
     if (u->status.labors[df::unit_labor::CUTWOOD])
         labor_skill = df::job_skill::AXE;
     if (weapon_skill == labor_skill && !(labor_skill == df::job_skill::AXE && item->getSharpness() <= 0))
-        return;
-    // TODO: cancel using df::job_cancel_reason::EQUIPMENT_MISMATCH
-    Job::removeJob(job);
+        return nullptr;
+    return job;
 }
 
-void Labor::updateUnitLabor(df::unit *u)
+static void update_tools()
 {
-    if (game->external_flag & 1)
-        return;
+    std::vector<df::unit *> units;
+    for (auto [u, old_tool_labors]: tool_labors_before)
+        if (tool_labors(u) != old_tool_labors)
+            units.push_back(u);
+    tool_labors_before.clear();
+    // Cancel all mismatched jobs in one sweep
+    std::vector<df::job *> jobs;
+    for (auto u: units)
+        if (auto job = find_pickup_mismatched_equipment(u))
+            jobs.push_back(job);
+    std::ranges::sort(jobs);
+    jobs.erase(std::unique(jobs.begin(), jobs.end()), jobs.end());
+    for (auto job: jobs) {
+        // TODO: cancel using df::job_cancel_reason::EQUIPMENT_MISMATCH
+        Job::removeJob(job);
+    }
+    // Request re-equipment now or queue it for later updates
+    for (auto u: units) {
+        if (reequip_rate == 0)
+            u->military.pickup_flags.bits.update = true;
+        else if (reequip_queued.insert(u->id).second)
+            reequip_queue.push_back(u->id);
+    }
+}
+
+namespace {
+
+// Everything the labors of a unit are computed from. Units with equal inputs
+// get the same labors.
+struct LaborInputs
+{
+    enum Kind: std::uint8_t
+    {
+        NoLabors,
+        Chores,
+        WorkDetails,
+    };
+    Kind kind = NoLabors;
+    bool no_default_labors = false;
+    std::uint8_t medical = 0; // DIAGNOSE, SURGERY and BONE_SETTING bits
+    std::vector<df::work_detail *> work_details; // work details setting labors
+
+    bool operator==(const LaborInputs &) const = default;
+};
+
+struct LaborInputsHash
+{
+    std::size_t operator()(const LaborInputs &inputs) const
+    {
+        std::size_t h = inputs.kind | inputs.no_default_labors << 2 | inputs.medical << 3;
+        for (auto wd: inputs.work_details)
+            h = h * 31 + std::hash<df::work_detail *>{}(wd);
+        return h;
+    }
+};
+
+}
+
+static constexpr std::uint8_t MedicalDiagnose = 1;
+static constexpr std::uint8_t MedicalSurgery = 2;
+static constexpr std::uint8_t MedicalBoneSetting = 4;
+
+static bool work_detail_applies(df::work_detail *work_detail, df::unit *u, bool no_default_labors)
+{
+    switch (work_detail->work_detail_flags.bits.mode) {
+    case df::work_detail_mode::OnlySelectedDoesThis:
+        return vector_contains(work_detail->assigned_units, u->id);
+    case df::work_detail_mode::EverybodyDoesThis:
+        return !no_default_labors || vector_contains(work_detail->assigned_units, u->id);
+    default:
+        return false;
+    }
+}
+
+static void get_labor_inputs(df::unit *u, LaborInputs &inputs)
+{
+    inputs.no_default_labors = false;
+    inputs.medical = 0;
+    inputs.work_details.clear();
     if (u->profession == df::profession::BABY
             || Units::isTamable(u)
             || !Units::isFortControlled(u)) {
-        std::memset(u->status.labors, 0, LaborCount*sizeof(bool));
+        inputs.kind = LaborInputs::NoLabors;
     }
     else if (u->profession == df::profession::CHILD) {
         if (!plotinfo->labor_info.flags.bits.children_do_chores
                 || vector_contains(plotinfo->labor_info.chores_exempted_children, u->id))
-            std::memset(u->status.labors, 0, LaborCount*sizeof(bool));
+            inputs.kind = LaborInputs::NoLabors;
         else
-            std::memcpy(u->status.labors, plotinfo->labor_info.chores, LaborCount*sizeof(bool));
+            inputs.kind = LaborInputs::Chores;
     }
     else { // adult citizens
-        // save tool-using labors
-        bool old_mine = u->status.labors[df::unit_labor::MINE];
-        bool old_cutwood = u->status.labors[df::unit_labor::CUTWOOD];
-        bool old_hunt = u->status.labors[df::unit_labor::HUNT];
+        inputs.kind = LaborInputs::WorkDetails;
+        inputs.no_default_labors = UnitsEx::hasMenialWorkExemption(u, plotinfo->group_id) || u->flags4.bits.only_do_assigned_jobs;
+        for (auto work_detail: plotinfo->labor_info.work_details)
+            if (work_detail_applies(work_detail, u, inputs.no_default_labors))
+                inputs.work_details.push_back(work_detail);
+        for (auto o: u->occupations) {
+            switch (o->type) {
+            case df::occupation_type::DOCTOR:
+                inputs.medical |= MedicalDiagnose | MedicalSurgery | MedicalBoneSetting;
+                break;
+            case df::occupation_type::DIAGNOSTICIAN:
+                inputs.medical |= MedicalDiagnose;
+                break;
+            case df::occupation_type::SURGEON:
+                inputs.medical |= MedicalSurgery;
+                break;
+            case df::occupation_type::BONE_DOCTOR:
+                inputs.medical |= MedicalBoneSetting;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
 
+static void compute_labors(const LaborInputs &inputs, bool *labors)
+{
+    switch (inputs.kind) {
+    case LaborInputs::NoLabors:
+        std::memset(labors, 0, LaborCount*sizeof(bool));
+        break;
+    case LaborInputs::Chores:
+        std::memcpy(labors, plotinfo->labor_info.chores, LaborCount*sizeof(bool));
+        break;
+    case LaborInputs::WorkDetails:
         // set default labors
-        auto no_default_labors = UnitsEx::hasMenialWorkExemption(u, plotinfo->group_id) || u->flags4.bits.only_do_assigned_jobs;
-        memset(u->status.labors, !no_default_labors, LaborCount*sizeof(bool));
-        u->status.labors[df::unit_labor::MINE] = false;
-        u->status.labors[df::unit_labor::CUTWOOD] = false;
-        u->status.labors[df::unit_labor::HUNT] = false;
-        u->status.labors[df::unit_labor::FISH] = false;
-        u->status.labors[df::unit_labor::DIAGNOSE] = false;
-        u->status.labors[df::unit_labor::SURGERY] = false;
-        u->status.labors[df::unit_labor::BONE_SETTING] = false;
+        memset(labors, !inputs.no_default_labors, LaborCount*sizeof(bool));
+        labors[df::unit_labor::MINE] = false;
+        labors[df::unit_labor::CUTWOOD] = false;
+        labors[df::unit_labor::HUNT] = false;
+        labors[df::unit_labor::FISH] = false;
+        labors[df::unit_labor::DIAGNOSE] = false;
+        labors[df::unit_labor::SURGERY] = false;
+        labors[df::unit_labor::BONE_SETTING] = false;
 
         // clear labors from disabled/limited work details
         for (auto work_detail: plotinfo->labor_info.work_details) {
@@ -103,57 +235,136 @@ void Labor::updateUnitLabor(df::unit *u)
             default:
                 for (int i = 0; i < LaborCount; ++i)
                     if (work_detail->allowed_labors[i])
-                        u->status.labors[i] = false;
+                        labors[i] = false;
                 break;
             }
         }
         // set labors from work details
-        for (auto work_detail: plotinfo->labor_info.work_details) {
-            switch (work_detail->work_detail_flags.bits.mode) {
-            case df::work_detail_mode::OnlySelectedDoesThis:
-                if (vector_contains(work_detail->assigned_units, u->id))
-                    for (int i = 0; i < LaborCount; ++i)
-                        if (work_detail->allowed_labors[i])
-                            u->status.labors[i] = true;
-                break;
-            case df::work_detail_mode::EverybodyDoesThis:
-                if (!no_default_labors || vector_contains(work_detail->assigned_units, u->id))
-                    for (int i = 0; i < LaborCount; ++i)
-                        if (work_detail->allowed_labors[i])
-                            u->status.labors[i] = true;
-                break;
-            default:
-                break;
-            }
-        }
+        for (auto work_detail: inputs.work_details)
+            for (int i = 0; i < LaborCount; ++i)
+                if (work_detail->allowed_labors[i])
+                    labors[i] = true;
         // set labors for medical occupations
-        for (auto o: u->occupations) {
-            switch (o->type) {
-            case df::occupation_type::DOCTOR:
-                u->status.labors[df::unit_labor::DIAGNOSE] = true;
-                u->status.labors[df::unit_labor::SURGERY] = true;
-                u->status.labors[df::unit_labor::BONE_SETTING] = true;
-                break;
-            case df::occupation_type::DIAGNOSTICIAN:
-                u->status.labors[df::unit_labor::DIAGNOSE] = true;
-                break;
-            case df::occupation_type::SURGEON:
-                u->status.labors[df::unit_labor::SURGERY] = true;
-                break;
-            case df::occupation_type::BONE_DOCTOR:
-                u->status.labors[df::unit_labor::BONE_SETTING] = true;
-                break;
-            default:
-                break;
-            }
+        if (inputs.medical & MedicalDiagnose)
+            labors[df::unit_labor::DIAGNOSE] = true;
+        if (inputs.medical & MedicalSurgery)
+            labors[df::unit_labor::SURGERY] = true;
+        if (inputs.medical & MedicalBoneSetting)
+            labors[df::unit_labor::BONE_SETTING] = true;
+        break;
+    }
+}
+
+static void set_unit_labors(df::unit *u, const bool *labors, const LaborInputs &inputs)
+{
+    // save tool-using labors
+    if (inputs.kind == LaborInputs::WorkDetails)
+        tool_labors_before.try_emplace(u, tool_labors(u));
+    if (std::memcmp(u->status.labors, labors, LaborCount*sizeof(bool)) != 0) {
+        std::memcpy(u->status.labors, labors, LaborCount*sizeof(bool));
+        Generation::bumpUnitLabors(u);
+    }
+    Coverage::updateUnit(u, inputs.work_details);
+}
+
+static void update_all_unit_labors()
+{
+    if (game->external_flag & 1)
+        return;
+    // Labors are computed once for each distinct set of inputs
+    std::unordered_map<LaborInputs, std::array<bool, LaborCount>, LaborInputsHash> labor_classes;
+    LaborInputs inputs;
+    for (auto unit: world->units.active) {
+        get_labor_inputs(unit, inputs);
+        auto [it, inserted] = labor_classes.try_emplace(inputs);
+        if (inserted)
+            compute_labors(inputs, it->second.data());
+        set_unit_labors(unit, it->second.data(), inputs);
+    }
+}
+
+Labor::Batch::Batch()
+{
+    ++batch_depth;
+}
+
+Labor::Batch::~Batch() noexcept(false)
+{
+    if (batch_depth > 1) {
+        --batch_depth;
+        return;
+    }
+    // Leave the batch even if deferred updates throw
+    struct Leave
+    {
+        ~Leave()
+        {
+            full_update_pending = false;
+            tool_labors_before.clear();
+            --batch_depth;
         }
-        // update tool if labors were changed
-        if (old_mine != u->status.labors[df::unit_labor::MINE]
-                || old_cutwood != u->status.labors[df::unit_labor::CUTWOOD]
-                || old_hunt != u->status.labors[df::unit_labor::HUNT]) {
-            cancel_pickup_mismatched_equipment(u);
+    } leave;
+    if (full_update_pending) {
+        full_update_pending = false;
+        update_all_unit_labors();
+    }
+    update_tools();
+}
+
+void Labor::updateUnitLabor(df::unit *u)
+{
+    if (game->external_flag & 1)
+        return;
+    Batch batch;
+    LaborInputs inputs;
+    get_labor_inputs(u, inputs);
+    bool labors[LaborCount];
+    compute_labors(inputs, labors);
+    set_unit_labors(u, labors, inputs);
+}
+
+void Labor::updateAllUnitLabors()
+{
+    // Labors are updated once when the outermost batch ends
+    Batch batch;
+    full_update_pending = true;
+}
+
+void Labor::getAppliedWorkDetails(df::unit *u, std::vector<df::work_detail *> &work_details)
+{
+    LaborInputs inputs;
+    get_labor_inputs(u, inputs);
+    work_details = std::move(inputs.work_details);
+}
+
+void Labor::setReequipRate(std::size_t units_per_update)
+{
+    reequip_rate = units_per_update;
+}
+
+std::size_t Labor::reequipRate()
+{
+    return reequip_rate;
+}
+
+void Labor::processDeferredUpdates()
+{
+    auto count = reequip_rate == 0
+        ? reequip_queue.size()
+        : std::min(reequip_rate, reequip_queue.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        // units may have left since they were queued
+        auto id = reequip_queue.front();
+        reequip_queue.pop_front();
+        reequip_queued.erase(id);
+        if (auto u = df::unit::find(id))
             u->military.pickup_flags.bits.update = true;
-        }
     }
 }
 
+void Labor::clear()
+{
+    tool_labors_before.clear();
+    reequip_queue.clear();
+    reequip_queued.clear();
+}
@@ -21,10 +21,40 @@
 #pragma once
 
 #include "df/unit.h"
+#include "df/work_detail.h"
+
+#include <cstddef>
+#include <vector>
 
 namespace Labor
 {
 
+// Full labor updates and tool-labor side effects (cancelling mismatched
+// equipment pickup jobs and requesting re-equipment) are deferred until the
+// outermost batch ends, so they are processed once for the whole batch.
+class Batch
+{
+public:
+    Batch();
+    // May throw when the outermost batch processes deferred updates
+    ~Batch() noexcept(false);
+
+    Batch(const Batch &) = delete;
+    Batch &operator=(const Batch &) = delete;
+};
+
 void updateUnitLabor(df::unit *u);
+void updateAllUnitLabors();
+
+// Get the work details setting labors for the unit.
+void getAppliedWorkDetails(df::unit *u, std::vector<df::work_detail *> &work_details);
+
+// Maximum number of units requested to re-equip per update (0 is unlimited).
+void setReequipRate(std::size_t units_per_update);
+std::size_t reequipRate();
+// Send re-equipment requests delayed by the rate limit.
+void processDeferredUpdates();
+// Forget pending updates when the world or map is unloaded.
+void clear();
 
 }
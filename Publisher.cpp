@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2023 Clement Vuchener
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+#include "Publisher.h"
+#include "Generation.h"
+
+#include "Core.h"
+
+#include "df/plotinfost.h"
+#include "df/unit.h"
+#include "df/work_detail.h"
+#include "df/world.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+
+#if defined(_LINUX)
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
+
+using namespace DFHack;
+using df::global::plotinfo;
+using df::global::world;
+
+static constexpr int LaborCount = std::extent_v<decltype(df::unit::T_status::labors)>;
+static_assert(LaborCount <= 64*Publisher::LaborWords);
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+static std::string segment_name;
+static Publisher::SegmentHeader *segment = nullptr;
+static std::size_t segment_size = 0;
+// Bounds used for writing, never read back from the segment which other
+// processes may modify.
+static std::uint32_t segment_max_units = 0;
+static std::size_t segment_slot_size = 0;
+static std::uint64_t published_index = 0;
+static std::uint64_t published_generation = 0;
+
+static std::size_t slot_size(std::uint32_t max_units)
+{
+    return sizeof(Publisher::SlotHeader)
+        + Publisher::MaxWorkDetails*sizeof(Publisher::WorkDetailRecord)
+        + max_units*sizeof(Publisher::UnitRecord);
+}
+
+static void pack_labors(const bool *labors, std::uint64_t *words)
+{
+    std::fill_n(words, Publisher::LaborWords, 0);
+    for (int i = 0; i < LaborCount; ++i)
+        if (labors[i])
+            words[i/64] |= std::uint64_t(1) << (i%64);
+}
+
+static void write_snapshot(Publisher::SlotHeader *slot)
+{
+    using namespace Publisher;
+    auto work_detail_records = reinterpret_cast<WorkDetailRecord *>(slot+1);
+    auto unit_records = reinterpret_cast<UnitRecord *>(work_detail_records+MaxWorkDetails);
+    std::uint32_t work_detail_count = 0, unit_count = 0, dropped_units = 0;
+    if (Core::getInstance().isMapLoaded()) {
+        const auto &work_details = plotinfo->labor_info.work_details;
+        work_detail_count = std::min<std::size_t>(work_details.size(), MaxWorkDetails);
+        for (std::uint32_t i = 0; i < work_detail_count; ++i) {
+            auto wd = work_details[i];
+            auto &record = work_detail_records[i];
+            std::memset(record.name, 0, NameSize);
+            wd->name.copy(record.name, NameSize-1);
+            record.flags = wd->work_detail_flags.whole;
+            record.icon = static_cast<std::int32_t>(wd->icon);
+            pack_labors(wd->allowed_labors, record.labors);
+        }
+        std::unordered_map<int32_t, UnitRecord *> records_by_id;
+        const auto &units = world->units.active;
+        unit_count = std::min<std::size_t>(units.size(), segment_max_units);
+        dropped_units = units.size() - unit_count;
+        for (std::uint32_t i = 0; i < unit_count; ++i) {
+            auto u = units[i];
+            auto &record = unit_records[i];
+            record.id = u->id;
+            record.flags = 0;
+            if (u->flags4.bits.only_do_assigned_jobs)
+                record.flags |= OnlyDoAssignedJobs;
+            if (u->flags3.bits.available_for_adoption)
+                record.flags |= AvailableForAdoption;
+            if (u->flags2.bits.slaughter)
+                record.flags |= MarkedForSlaughter;
+            if (u->flags3.bits.marked_for_gelding)
+                record.flags |= MarkedForGelding;
+            record.work_details = 0;
+            pack_labors(u->status.labors, record.labors);
+            records_by_id.emplace(u->id, &record);
+        }
+        for (std::uint32_t i = 0; i < work_detail_count; ++i) {
+            for (auto id: work_details[i]->assigned_units) {
+                auto it = records_by_id.find(id);
+                if (it != records_by_id.end())
+                    it->second->work_details |= std::uint64_t(1) << i;
+            }
+        }
+    }
+    slot->generation = Generation::current();
+    slot->work_detail_count = work_detail_count;
+    slot->unit_count = unit_count;
+    slot->dropped_units = dropped_units;
+}
+
+static void publish()
+{
+    using namespace Publisher;
+    auto index = ++published_index;
+    auto slot = reinterpret_cast<SlotHeader *>(
+            reinterpret_cast<char *>(segment+1) + (index % SlotCount)*segment_slot_size);
+    auto sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    write_snapshot(slot);
+    slot->sequence.store(sequence+2, std::memory_order_release);
+    segment->latest.store(index, std::memory_order_release);
+    published_generation = Generation::current();
+}
+
+#if defined(_LINUX)
+
+bool Publisher::start(color_ostream &out, const std::string &name, std::uint32_t max_units)
+{
+    if (segment) {
+        out.printerr("Already publishing to %s\n", segment_name.c_str());
+        return false;
+    }
+    // Never take over a segment from another process, it is only unlinked by
+    // this process if it was created here.
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd == -1) {
+        out.printerr("Failed to create shared memory %s: %s\n", name.c_str(), strerror(errno));
+        if (errno == EEXIST)
+            out.printerr("Use \"laborpublish unlink %s\" if it is a stale segment\n", name.c_str());
+        return false;
+    }
+    std::size_t size = sizeof(SegmentHeader) + SlotCount*slot_size(max_units);
+    if (ftruncate(fd, size) == -1) {
+        out.printerr("Failed to resize shared memory %s: %s\n", name.c_str(), strerror(errno));
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    auto addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        out.printerr("Failed to map shared memory %s: %s\n", name.c_str(), strerror(errno));
+        shm_unlink(name.c_str());
+        return false;
+    }
+    std::memset(addr, 0, size);
+    segment = new (addr) SegmentHeader{};
+    segment->magic = Magic;
+    segment->version = Version;
+    segment->slot_count = SlotCount;
+    segment->max_units = max_units;
+    segment->slot_size = slot_size(max_units);
+    segment->labor_count = LaborCount;
+    segment_name = name;
+    segment_size = size;
+    segment_max_units = max_units;
+    segment_slot_size = slot_size(max_units);
+    published_index = 0;
+    publish();
+    return true;
+}
+
+void Publisher::stop()
+{
+    if (!segment)
+        return;
+    munmap(segment, segment_size);
+    shm_unlink(segment_name.c_str());
+    segment = nullptr;
+    segment_name.clear();
+}
+
+bool Publisher::unlink(color_ostream &out, const std::string &name)
+{
+    if (segment && name == segment_name) {
+        out.printerr("%s is in use, stop publishing instead\n", name.c_str());
+        return false;
+    }
+    if (shm_unlink(name.c_str()) == -1) {
+        out.printerr("Failed to remove shared memory %s: %s\n", name.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool Publisher::start(color_ostream &out, const std::string &name, std::uint32_t max_units)
+{
+    out.printerr("Shared memory publishing is not supported on this platform\n");
+    return false;
+}
+
+void Publisher::stop()
+{
+}
+
+bool Publisher::unlink(color_ostream &out, const std::string &name)
+{
+    out.printerr("Shared memory publishing is not supported on this platform\n");
+    return false;
+}
+
+#endif
+
+bool Publisher::isActive()
+{
+    return segment;
+}
+
+const std::string &Publisher::name()
+{
+    return segment_name;
+}
+
+void Publisher::update()
+{
+    if (segment && Generation::current() != published_generation)
+        publish();
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2023 Clement Vuchener
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#pragma once
+
+#include "ColorText.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Publish unit labors and work details in a POSIX shared memory segment.
+//
+// The segment starts with a SegmentHeader followed by slot_count slots of
+// slot_size bytes. Each slot contains a SlotHeader, MaxWorkDetails
+// WorkDetailRecord and max_units UnitRecord. Snapshots are written in the
+// slot following the latest one, `latest` is then incremented.
+//
+// Slots are protected by a seqlock: readers must read `sequence`, retry if it
+// is odd, copy the records, and retry if `sequence` changed meanwhile.
+namespace Publisher
+{
+
+constexpr std::uint32_t Magic = 0x53544457; // "WDTS"
+constexpr std::uint32_t Version = 1;
+constexpr std::uint32_t SlotCount = 4;
+constexpr std::uint32_t MaxWorkDetails = 64;
+constexpr std::uint32_t LaborWords = 2;
+constexpr std::uint32_t NameSize = 64;
+
+struct SegmentHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t slot_count;
+    std::uint32_t max_units;
+    std::uint64_t slot_size;
+    std::uint32_t labor_count;
+    std::uint32_t reserved;
+    std::atomic<std::uint64_t> latest; // latest % slot_count is the last written slot, 0 if none
+};
+
+struct SlotHeader
+{
+    std::atomic<std::uint64_t> sequence; // odd while the slot is being written
+    std::uint64_t generation;
+    std::uint32_t work_detail_count;
+    std::uint32_t unit_count;
+    std::uint32_t dropped_units; // units not published because max_units is too small
+    std::uint32_t reserved;
+};
+
+struct WorkDetailRecord
+{
+    char name[NameSize]; // null-terminated, may be truncated
+    std::uint32_t flags; // work_detail_flags
+    std::int32_t icon;
+    std::uint64_t labors[LaborWords]; // bit i: labor i is allowed
+};
+
+enum UnitFlagBits: std::uint32_t
+{
+    OnlyDoAssignedJobs = 1 << 0,
+    AvailableForAdoption = 1 << 1,
+    MarkedForSlaughter = 1 << 2,
+    MarkedForGelding = 1 << 3,
+};
+
+struct UnitRecord
+{
+    std::int32_t id;
+    std::uint32_t flags; // UnitFlagBits
+    std::uint64_t work_details; // bit i: assigned to work detail i
+    std::uint64_t labors[LaborWords]; // bit i: labor i is enabled
+};
+
+// Fails if a segment with the same name already exists.
+bool start(DFHack::color_ostream &out, const std::string &name, std::uint32_t max_units);
+void stop();
+// Remove a stale segment left by a previous session.
+bool unlink(DFHack::color_ostream &out, const std::string &name);
+bool isActive();
+const std::string &name();
+
+// Publish a new snapshot if the generation changed since the last one.
+void update();
+
+}
@@ -23,6 +23,10 @@
 #include "DataDefs.h"
 #include "modules/Translation.h"
 #include "modules/Job.h"
+#include "modules/Units.h"
+#include "Coverage.h"
+#include "Generation.h"
+#include "Publisher.h"
 #include "UnitsEx.h"
 #include "Labor.h"
 
@@ -36,9 +40,18 @@
 
 #include "workdetailtest.pb.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <random>
 #include <format>
 #include <cstring>
+#include <string_view>
+#include <thread>
 
 #if defined(WIN32)
 #   include <windows.h>
@@ -78,14 +91,238 @@ static command_result do_labor_update_test(color_ostream &out, std::vector<std::
     return CR_OK;
 }
 
+// Mutations from all connections are queued, the first request of a group
+// waits for the commit window then executes the whole group in arrival order
+// under a single core suspend and a single labor update.
+namespace {
+
+struct PendingCommit
+{
+    std::function<command_result()> run;
+    command_result result = CR_FAILURE;
+    bool done = false;
+};
+
+}
+
+static std::atomic<std::uint32_t> commit_window_us = 0;
+static std::mutex commit_mutex;
+static std::condition_variable commit_cv;
+static std::vector<PendingCommit *> commit_queue;
+static bool commit_leader = false;
+
+// Group of commits executed by the leader. Waiting connections are always
+// released when it is destroyed, even if the group failed with an exception.
+class CommitGroup
+{
+public:
+    ~CommitGroup()
+    {
+        std::lock_guard lock(commit_mutex);
+        if (!taken)
+            take_locked();
+        for (auto c: commits)
+            c->done = true;
+        commit_cv.notify_all();
+    }
+
+    // requests arriving from now on are for the next group
+    void take()
+    {
+        std::lock_guard lock(commit_mutex);
+        take_locked();
+    }
+
+    std::vector<PendingCommit *> commits;
+
+private:
+    void take_locked()
+    {
+        commits = std::move(commit_queue);
+        commit_queue.clear();
+        commit_leader = false;
+        taken = true;
+    }
+
+    bool taken = false;
+};
+
+static command_result group_commit(std::function<command_result()> run)
+{
+    PendingCommit commit{std::move(run)};
+    std::unique_lock lock(commit_mutex);
+    commit_queue.push_back(&commit);
+    if (!commit_leader) {
+        commit_leader = true;
+        lock.unlock();
+        {
+            CommitGroup group;
+            if (auto window = commit_window_us.load())
+                std::this_thread::sleep_for(std::chrono::microseconds(window));
+            CoreSuspender suspend;
+            group.take();
+            try {
+                Labor::Batch labor_batch;
+                for (auto c: group.commits) {
+                    try {
+                        c->result = c->run();
+                    }
+                    catch (std::exception &e) {
+                        Core::printerr("workdetailtest: request failed: %s\n", e.what());
+                        c->result = CR_FAILURE;
+                    }
+                    catch (...) {
+                        Core::printerr("workdetailtest: request failed\n");
+                        c->result = CR_FAILURE;
+                    }
+                }
+            }
+            catch (...) {
+                // the shared labor update failed, changes are only partially applied
+                Core::printerr("workdetailtest: labor update failed\n");
+                for (auto c: group.commits)
+                    c->result = CR_FAILURE;
+            }
+        }
+        lock.lock();
+    }
+    commit_cv.wait(lock, [&]() { return commit.done; });
+    return commit.result;
+}
+
+template <auto Function>
+struct GroupCommit;
+
+template <typename In, typename Out, command_result (*Function)(color_ostream &, const In *, Out *)>
+struct GroupCommit<Function>
+{
+    static command_result call(color_ostream &out, const In *in, Out *result)
+    {
+        return group_commit([&]() { return Function(out, in, result); });
+    }
+};
+
+static command_result do_labor_commit_window(color_ostream &out, std::vector<std::string> &parameters)
+{
+    if (parameters.empty()) {
+        out.print("Commit window: %u microseconds\n", commit_window_us.load());
+        return CR_OK;
+    }
+    if (parameters.size() != 1)
+        return CR_WRONG_USAGE;
+    const auto &arg = parameters[0];
+    std::uint32_t window;
+    auto [end, ec] = std::from_chars(arg.data(), arg.data()+arg.size(), window);
+    if (ec != std::errc() || end != arg.data()+arg.size()) {
+        out.printerr("Invalid window: %s\n", arg.c_str());
+        return CR_WRONG_USAGE;
+    }
+    commit_window_us = window;
+    return CR_OK;
+}
+
+static command_result do_labor_publish(color_ostream &out, std::vector<std::string> &parameters)
+{
+    if (parameters.empty()) {
+        if (Publisher::isActive())
+            out.print("Publishing to %s\n", Publisher::name().c_str());
+        else
+            out.print("Not publishing\n");
+        return CR_OK;
+    }
+    std::string name = parameters.size() > 1 ? parameters[1] : "/dfhack-workdetailtest";
+    if (parameters[0] == "start" && parameters.size() <= 3) {
+        std::uint32_t max_units = 4096;
+        if (parameters.size() > 2) {
+            const auto &arg = parameters[2];
+            auto [end, ec] = std::from_chars(arg.data(), arg.data()+arg.size(), max_units);
+            if (ec != std::errc() || end != arg.data()+arg.size() || max_units == 0) {
+                out.printerr("Invalid unit count: %s\n", arg.c_str());
+                return CR_WRONG_USAGE;
+            }
+        }
+        return Publisher::start(out, name, max_units) ? CR_OK : CR_FAILURE;
+    }
+    if (parameters[0] == "stop" && parameters.size() == 1) {
+        Publisher::stop();
+        return CR_OK;
+    }
+    if (parameters[0] == "unlink" && parameters.size() <= 2)
+        return Publisher::unlink(out, name) ? CR_OK : CR_FAILURE;
+    return CR_WRONG_USAGE;
+}
+
+static command_result do_labor_reequip_rate(color_ostream &out, std::vector<std::string> &parameters)
+{
+    if (parameters.empty()) {
+        out.print("Re-equipment rate: %zu units per update (0 is unlimited)\n", Labor::reequipRate());
+        return CR_OK;
+    }
+    if (parameters.size() != 1)
+        return CR_WRONG_USAGE;
+    const auto &arg = parameters[0];
+    std::size_t rate;
+    auto [end, ec] = std::from_chars(arg.data(), arg.data()+arg.size(), rate);
+    if (ec != std::errc() || end != arg.data()+arg.size()) {
+        out.printerr("Invalid rate: %s\n", arg.c_str());
+        return CR_WRONG_USAGE;
+    }
+    Labor::setReequipRate(rate);
+    return CR_OK;
+}
+
 DFhackCExport command_result plugin_init(color_ostream &out, std::vector<PluginCommand> &commands)
 {
     commands.push_back(PluginCommand("laborupdatetest", "test labor update", do_labor_update_test));
+    commands.push_back(PluginCommand("laborpublish", "publish labors in shared memory", do_labor_publish));
+    commands.push_back(PluginCommand("laborreequiprate", "limit re-equipment requests per update", do_labor_reequip_rate));
+    commands.push_back(PluginCommand("laborcommitwindow", "set the window for grouping remote edits", do_labor_commit_window));
     return CR_OK;
 }
 
 DFhackCExport command_result plugin_shutdown(color_ostream &out)
 {
+    Publisher::stop();
+    return CR_OK;
+}
+
+// Look for changes made from the game interface
+static void check_game_changes()
+{
+    if (!Core::getInstance().isMapLoaded())
+        return;
+    Generation::Changes changes;
+    Generation::check(changes);
+    if (changes.work_details) {
+        Coverage::refresh();
+        return;
+    }
+    for (auto id: changes.removed_units)
+        Coverage::removeUnit(id);
+    for (auto u: changes.unit_labors)
+        Coverage::refreshUnit(u);
+}
+
+DFhackCExport command_result plugin_onupdate(color_ostream &out)
+{
+    check_game_changes();
+    Labor::processDeferredUpdates();
+    Publisher::update();
+    return CR_OK;
+}
+
+DFhackCExport command_result plugin_onstatechange(color_ostream &out, state_change_event event)
+{
+    switch (event) {
+    case SC_WORLD_UNLOADED:
+    case SC_MAP_UNLOADED:
+        Generation::clear();
+        Coverage::clear();
+        Labor::clear();
+        break;
+    default:
+        break;
+    }
     return CR_OK;
 }
 
@@ -102,6 +339,110 @@ static command_result get_process_info(color_ostream &out, const EmptyMessage *,
     return CR_OK;
 }
 
+// Find offset and size of a field from a dot-separated path in type identities
+static bool find_field(struct_identity *type, std::string_view path, std::size_t &offset, std::size_t &size)
+{
+    offset = 0;
+    while (type) {
+        auto dot = path.find('.');
+        auto name = path.substr(0, dot);
+        const struct_field_info *field = nullptr;
+        for (auto t = type; t && !field; t = t->getParent()) {
+            for (auto f = t->getFields(); f && f->mode != struct_field_info::END; ++f) {
+                if (f->name && name == f->name) {
+                    field = f;
+                    break;
+                }
+            }
+        }
+        if (!field)
+            return false;
+        offset += field->offset;
+        if (dot == std::string_view::npos) {
+            switch (field->mode) {
+            case struct_field_info::STATIC_ARRAY:
+                size = field->count * field->type->byte_size();
+                break;
+            case struct_field_info::STATIC_STRING:
+                size = field->count;
+                break;
+            case struct_field_info::POINTER:
+                size = sizeof(void *);
+                break;
+            case struct_field_info::STL_VECTOR_PTR:
+                size = sizeof(std::vector<void *>);
+                break;
+            default:
+                size = field->type ? field->type->byte_size() : 0;
+                break;
+            }
+            return true;
+        }
+        if (field->mode != struct_field_info::SUBSTRUCT || !field->type)
+            return false;
+        switch (field->type->type()) {
+        case IDTYPE_STRUCT:
+        case IDTYPE_CLASS:
+            type = static_cast<struct_identity *>(field->type);
+            break;
+        default:
+            return false;
+        }
+        path = path.substr(dot+1);
+    }
+    return false;
+}
+
+static void set_struct_layout(
+        StructLayout *layout,
+        struct_identity *type,
+        std::initializer_list<std::string_view> fields)
+{
+    layout->set_size(type->byte_size());
+    layout->mutable_fields()->Reserve(fields.size());
+    for (auto path: fields) {
+        auto field = layout->add_fields();
+        field->set_name(std::string(path));
+        std::size_t offset, size;
+        if (find_field(type, path, offset, size)) {
+            field->set_offset(offset);
+            field->set_size(size);
+        }
+    }
+}
+
+static command_result get_memory_layout(color_ostream &out, const EmptyMessage *, MemoryLayout *layout)
+{
+    layout->set_units_active(reinterpret_cast<uintptr_t>(&world->units.active));
+    layout->set_work_details(reinterpret_cast<uintptr_t>(&plotinfo->labor_info.work_details));
+    layout->set_chores(reinterpret_cast<uintptr_t>(&plotinfo->labor_info.chores));
+    layout->set_chores_exempted_children(reinterpret_cast<uintptr_t>(&plotinfo->labor_info.chores_exempted_children));
+    layout->set_labor_count(LaborCount);
+    layout->set_vector_size(sizeof(std::vector<void *>));
+    set_struct_layout(layout->mutable_unit(), &df::unit::_identity, {
+            "id",
+            "race",
+            "caste",
+            "sex",
+            "profession",
+            "hist_figure_id",
+            "name.nickname",
+            "flags1",
+            "flags2",
+            "flags3",
+            "flags4",
+            "status.labors",
+        });
+    set_struct_layout(layout->mutable_work_detail(), &df::work_detail::_identity, {
+            "name",
+            "work_detail_flags",
+            "allowed_labors",
+            "assigned_units",
+            "icon",
+        });
+    return CR_OK;
+}
+
 static command_result get_game_state(color_ostream &out, const EmptyMessage *, GameState *state)
 {
     auto &core = Core::getInstance();
@@ -115,6 +456,65 @@ static command_result get_game_state(color_ostream &out, const EmptyMessage *, G
             break;
         }
     }
+    check_game_changes();
+    state->set_generation(Generation::current());
+    return CR_OK;
+}
+
+static command_result get_generations(color_ostream &out, const GetGenerations *get, Generations *generations)
+{
+    check_game_changes();
+    auto current = Generation::current();
+    generations->set_generation(current);
+    if (get->has_if_none_match() && get->if_none_match() == current) {
+        generations->set_unchanged(true);
+        return CR_OK;
+    }
+    // a generation from the future comes from another plugin instance: read everything
+    auto since = get->if_none_match() < current ? get->if_none_match() : 0;
+    generations->set_work_detail_list(Generation::workDetailList());
+    generations->set_unit_list(Generation::unitList());
+    const auto &work_details = plotinfo->labor_info.work_details;
+    for (std::size_t i = 0; i < work_details.size(); ++i) {
+        auto generation = Generation::workDetail(work_details[i]);
+        if (generation <= since)
+            continue;
+        auto wd = generations->add_work_details();
+        wd->mutable_id()->set_index(i);
+        wd->mutable_id()->set_name(work_details[i]->name);
+        wd->set_generation(generation);
+    }
+    for (auto unit: world->units.active) {
+        auto labors = Generation::unitLabors(unit);
+        auto flags = Generation::unitFlags(unit);
+        if (labors <= since && flags <= since)
+            continue;
+        auto u = generations->add_units();
+        u->mutable_id()->set_id(unit->id);
+        u->set_labors(labors);
+        u->set_flags(flags);
+    }
+    return CR_OK;
+}
+
+static command_result get_labor_coverage(color_ostream &out, const EmptyMessage *, LaborCoverage *coverage)
+{
+    check_game_changes();
+    coverage->mutable_labor_units()->Reserve(LaborCount);
+    for (int i = 0; i < LaborCount; ++i)
+        coverage->add_labor_units(Coverage::laborUnits(i));
+    const auto &work_details = plotinfo->labor_info.work_details;
+    coverage->mutable_work_details()->Reserve(work_details.size());
+    for (std::size_t i = 0; i < work_details.size(); ++i) {
+        auto wd = coverage->add_work_details();
+        wd->mutable_id()->set_index(i);
+        wd->mutable_id()->set_name(work_details[i]->name);
+        auto units = Coverage::workDetailUnits(work_details[i]);
+        wd->set_units(units);
+        wd->mutable_labor_units()->Reserve(LaborCount);
+        for (int j = 0; j < LaborCount; ++j)
+            wd->add_labor_units(work_details[i]->allowed_labors[j] ? units : 0);
+    }
     return CR_OK;
 }
 
@@ -125,9 +525,9 @@ static void set_error(Result *result, std::format_string<Args...> fmt, Args &&..
         result->set_error(std::format(fmt, std::forward<Args>(args)...));
 }
 
-static df::unit *find_unit(const UnitId &id, Result *result)
+static df::unit *check_unit(df::unit *unit, const UnitId &id, Result *result)
 {
-    if (auto unit = df::unit::find(id.id())) {
+    if (unit) {
         result->set_success(true);
         return unit;
     }
@@ -137,6 +537,36 @@ static df::unit *find_unit(const UnitId &id, Result *result)
     }
 }
 
+static df::unit *find_unit(const UnitId &id, Result *result)
+{
+    return check_unit(df::unit::find(id.id()), id, result);
+}
+
+// Find units for all ids (given by projection on range) with a single merge
+// over the sorted unit vector. Returns nullptr for unknown ids.
+template <typename Range, typename Proj>
+static std::vector<df::unit *> find_units(const Range &range, Proj id_of)
+{
+    std::vector<std::pair<int32_t, std::size_t>> ids; // id, position in range
+    ids.reserve(range.size());
+    for (const auto &item: range)
+        ids.emplace_back(id_of(item), ids.size());
+    std::ranges::sort(ids);
+    std::vector<df::unit *> units(ids.size(), nullptr);
+    const auto &all = world->units.all;
+    auto it = all.begin();
+    for (auto [id, pos]: ids) {
+        it = std::lower_bound(it, all.end(), id, [](df::unit *u, int32_t id) {
+                return u->id < id;
+            });
+        if (it == all.end())
+            break;
+        if ((*it)->id == id)
+            units[pos] = *it;
+    }
+    return units;
+}
+
 static void set_geld(df::unit *u, bool geld);
 static void set_slaughter(df::unit *u, bool slaughter)
 {
@@ -251,6 +681,7 @@ static command_result set_unit_properties(
         }
 
     }
+    Generation::bumpUnitFlags(unit);
     return CR_OK;
 }
 
@@ -263,10 +694,96 @@ static command_result edit_unit(color_ostream &out, const EditUnit *edit, UnitRe
 
 static command_result edit_units(color_ostream &out, const EditUnits *edit, UnitResults *results)
 {
+    auto units = find_units(edit->units(), [](const EditUnit &unit_edit) {
+            return unit_edit.id().id();
+        });
     results->mutable_results()->Reserve(edit->units().size());
-    for (const auto &edit: edit->units()) {
+    for (int i = 0; i < edit->units_size(); ++i) {
+        const auto &unit_edit = edit->units(i);
         auto result = results->mutable_results()->Add();
-        edit_unit(out, &edit, result);
+        if (auto unit = check_unit(units[i], unit_edit.id(), result->mutable_unit()))
+            set_unit_properties(out, unit, unit_edit.changes(), result);
+    }
+    return CR_OK;
+}
+
+static bool get_unit_flag(df::unit *unit, UnitFlag flag, bool &value)
+{
+    switch (flag) {
+    case OnlyDoAssignedJobs:
+        value = unit->flags4.bits.only_do_assigned_jobs;
+        return true;
+    case AvailableForAdoption:
+        value = unit->flags3.bits.available_for_adoption;
+        return true;
+    case MarkedForSlaughter:
+        value = unit->flags2.bits.slaughter;
+        return true;
+    case MarkedForGelding:
+        value = unit->flags3.bits.marked_for_gelding;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool match_unit(df::unit *unit, const UnitPredicate &where)
+{
+    if (where.has_race() && unit->race != where.race())
+        return false;
+    if (where.has_caste() && unit->caste != where.caste())
+        return false;
+    if (where.has_sex() && unit->sex != where.sex())
+        return false;
+    if (where.has_fort_controlled() && Units::isFortControlled(unit) != where.fort_controlled())
+        return false;
+    if (where.has_tame() && Units::isTame(unit) != where.tame())
+        return false;
+    if (where.has_pet() && Units::isPet(unit) != where.pet())
+        return false;
+    if (where.has_min_age() || where.has_max_age()) {
+        auto age = Units::getAge(unit, true);
+        if (where.has_min_age() && age < where.min_age())
+            return false;
+        if (where.has_max_age() && age > where.max_age())
+            return false;
+    }
+    for (const auto &flag: where.flags()) {
+        bool value;
+        if (!get_unit_flag(unit, flag.flag(), value) || value != flag.value())
+            return false;
+    }
+    if (where.has_geldable() && UnitsEx::isGeldable(unit) != where.geldable())
+        return false;
+    if (where.has_slaughterable() && UnitsEx::isSlaughterable(unit) != where.slaughterable())
+        return false;
+    if (where.has_can_be_adopted() && UnitsEx::canBeAdopted(unit) != where.can_be_adopted())
+        return false;
+    return true;
+}
+
+static command_result edit_units_where(color_ostream &out, const EditUnitsWhere *edit, UnitResults *results)
+{
+    // Refuse requests that could flag every unit on the map: the predicate
+    // must restrict units to a race, or to tame or fort controlled units.
+    const auto &where = edit->where();
+    if (!where.has_race()
+            && !(where.has_tame() && where.tame())
+            && !(where.has_fort_controlled() && where.fort_controlled())) {
+        out.printerr("EditUnitsWhere requires a race, tame or fort_controlled condition\n");
+        return CR_WRONG_USAGE;
+    }
+    if (edit->changes().has_nickname()) {
+        out.printerr("EditUnitsWhere cannot change nicknames\n");
+        return CR_WRONG_USAGE;
+    }
+    for (auto unit: world->units.active) {
+        if (!match_unit(unit, edit->where()))
+            continue;
+        auto result = results->mutable_results()->Add();
+        result->mutable_id()->set_id(unit->id);
+        result->mutable_unit()->set_success(true);
+        set_unit_properties(out, unit, edit->changes(), result);
     }
     return CR_OK;
 }
@@ -278,6 +795,8 @@ static command_result set_work_detail_properties(
         WorkDetailResult *result,
         bool update_labors_for_all = false)
 {
+    // Process tool changes once all labors are updated
+    Labor::Batch labor_batch;
     // Name
     if (props.has_name()) {
         work_detail->name = props.name();
@@ -307,9 +826,13 @@ static command_result set_work_detail_properties(
     // Assignments
     if (auto s = props.assignments_size())
         result->mutable_assignments()->Reserve(s);
-    for (const auto &assign: props.assignments()) {
+    auto assigned_units = find_units(props.assignments(), [](const WorkDetailAssignment &assign) {
+            return assign.unit_id();
+        });
+    for (int i = 0; i < props.assignments_size(); ++i) {
+        const auto &assign = props.assignments(i);
         auto r = result->mutable_assignments()->Add();
-        auto unit = df::unit::find(assign.unit_id());
+        auto unit = assigned_units[i];
         if (!unit) {
             set_error(r, "unit {} not found", assign.unit_id());
             continue;
@@ -359,11 +882,10 @@ static command_result set_work_detail_properties(
         work_detail->work_detail_flags.bits.no_modify = props.no_modify();
     if (props.has_cannot_be_everybody())
         work_detail->work_detail_flags.bits.cannot_be_everybody = props.cannot_be_everybody();
+    Generation::bumpWorkDetail(work_detail);
     // Update all labors in case of global work detail changes
-    if (update_labors_for_all) {
-        for (auto unit: world->units.active)
-            Labor::updateUnitLabor(unit);
-    }
+    if (update_labors_for_all)
+        Labor::updateAllUnitLabors();
     return CR_OK;
 }
 
@@ -416,6 +938,7 @@ static command_result add_work_detail(
         ? work_details.begin() + add->position()
         : work_details.end();
     work_details.insert(insert_pos, new_work_detail);
+    Generation::bumpWorkDetailList();
     result->mutable_work_detail()->set_success(true);
     // Set new work detail properties
     return set_work_detail_properties(out, new_work_detail, add->properties(), result, true);
@@ -435,9 +958,9 @@ static command_result remove_work_detail(
     // Delete
     delete *work_detail;
     plotinfo->labor_info.work_details.erase(work_detail);
+    Generation::bumpWorkDetailList();
     // Update labors
-    for (auto unit: world->units.active)
-        Labor::updateUnitLabor(unit);
+    Labor::updateAllUnitLabors();
     return CR_OK;
 }
 
@@ -475,6 +998,7 @@ static command_result move_work_detail(
         std::rotate(work_detail, next(work_detail), new_pos_it);
     else
         std::rotate(new_pos_it, work_detail, next(work_detail));
+    Generation::bumpWorkDetailList();
     return CR_OK;
 }
 
@@ -482,12 +1006,16 @@ DFhackCExport RPCService *plugin_rpcconnect(color_ostream &out)
 {
     RPCService *svc = new RPCService();
     svc->addFunction("GetProcessInfo", get_process_info, SF_ALLOW_REMOTE | SF_DONT_SUSPEND);
+    svc->addFunction("GetMemoryLayout", get_memory_layout, SF_ALLOW_REMOTE | SF_DONT_SUSPEND);
     svc->addFunction("GetGameState", get_game_state, SF_ALLOW_REMOTE);
-    svc->addFunction("EditUnit", edit_unit, SF_ALLOW_REMOTE);
-    svc->addFunction("EditUnits", edit_units, SF_ALLOW_REMOTE);
-    svc->addFunction("EditWorkDetail", edit_work_detail, SF_ALLOW_REMOTE);
-    svc->addFunction("AddWorkDetail", add_work_detail, SF_ALLOW_REMOTE);
-    svc->addFunction("RemoveWorkDetail", remove_work_detail, SF_ALLOW_REMOTE);
-    svc->addFunction("MoveWorkDetail", move_work_detail, SF_ALLOW_REMOTE);
+    svc->addFunction("GetGenerations", get_generations, SF_ALLOW_REMOTE);
+    svc->addFunction("GetLaborCoverage", get_labor_coverage, SF_ALLOW_REMOTE);
+    svc->addFunction("EditUnit", GroupCommit<edit_unit>::call, SF_ALLOW_REMOTE | SF_DONT_SUSPEND);
+    svc->addFunction("EditUnits", GroupCommit<edit_units>::call, SF_ALLOW_REMOTE | SF_DONT_SUSPEND);
+    svc->addFunction("EditUnitsWhere", GroupCommit<edit_units_where>::call, SF_ALLOW_REMOTE | SF_DONT_SUSPEND);
+    svc->addFunction("EditWorkDetail", GroupCommit<edit_work_detail>::call, SF_ALLOW_REMOTE | SF_DONT_SUSPEND);
+    svc->addFunction("AddWorkDetail", GroupCommit<add_work_detail>::call, SF_ALLOW_REMOTE | SF_DONT_SUSPEND);
+    svc->addFunction("RemoveWorkDetail", GroupCommit<remove_work_detail>::call, SF_ALLOW_REMOTE | SF_DONT_SUSPEND);
+    svc->addFunction("MoveWorkDetail", GroupCommit<move_work_detail>::call, SF_ALLOW_REMOTE | SF_DONT_SUSPEND);
     return svc;
 }